@@ -0,0 +1,19 @@
+#ifndef AXCC_AST_FIXTURES_HH_
+#define AXCC_AST_FIXTURES_HH_
+
+#include <string>
+#include <vector>
+
+namespace axcc {
+
+// Fixtures in testfiles with golden AST output and errors, shared by every
+// test that runs over all of them. const_folding is left out because it
+// is only printed with folding enabled.
+const std::vector<std::string> kAstFixtures{
+    "obj_decls", "func_decls", "structs", "unions", "enums",
+    "complicated_types", "initializers", "statements", "expressions",
+    "precedence", "interned_types"};
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <memory>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "error.hh"
+#include "scanner.hh"
+#include "file_manager.hh"
+#include "preprocessor.hh"
+#include "parser.hh"
+#include "ast_serializer.hh"
+#include "ast_fixtures.hh"
+
+namespace axcc {
+
+class AstSerializerTest : public ::testing::TestWithParam<std::string> {
+protected:
+    ~AstSerializerTest() {
+        // Send diagnostics to std::cerr again.
+        DiagEngine::Instance().SetOutput(std::cerr);
+    }
+    void InitParser(const std::string& fname) {
+        TurnOffColorOutput();
+        // Diagnostics are checked by parser_test, so just discard them.
+        DiagEngine::Instance().SetOutput(diag_buf_);
+        DiagEngine::Instance().Reset();
+        filep_ = FileManager::Instance().GetFile(fname);
+        ASSERT_NE(filep_, nullptr) << fname << " not found";
+        Scanner scanner{fname, filep_->Content()};
+        tsp_ = scanner.Scan();
+        Preprocessor pp{*tsp_, FileManager::Instance(),
+                        std::list<std::string>{}};
+        pp.Preprocess();
+        parserp_ = std::make_unique<Parser>(*tsp_);
+    }
+
+    std::shared_ptr<const FileEntry> filep_{};
+    std::unique_ptr<TokenSequence> tsp_{};
+    std::unique_ptr<Parser> parserp_{};
+    std::stringstream diag_buf_{};
+};
+
+TEST_P(AstSerializerTest, RoundTrip) {
+    ASSERT_NO_FATAL_FAILURE(InitParser(GetParam() + ".c"));
+    auto& tu = parserp_->Parse();
+    const std::string path{::testing::TempDir() + GetParam() + ".axast"};
+    ASSERT_TRUE(WriteAst(tu, path));
+    std::unique_ptr<AstFile> astp =
+        AstFile::Load(path, FileManager::Instance());
+    // The mapping stays valid after the file is unlinked, so nothing is left
+    // behind even if a check below fails.
+    std::remove(path.c_str());
+    ASSERT_NE(astp, nullptr);
+    // Nodes are materialized lazily from the mapped file.
+    EXPECT_EQ(astp->NumMaterializedNodes(), 0);
+    // Source locations of the top-level declarations survive the round trip.
+    ASSERT_EQ(astp->NumDecls(), tu.NumDecls());
+    for (std::size_t i = 0; i < tu.NumDecls(); ++i)
+        EXPECT_EQ(LocStr(astp->Decl(i).Loc()), LocStr(tu.Decl(i).Loc()));
+    std::stringstream output_buf;
+    astp->Print(output_buf);
+    EXPECT_EQ(output_buf.str(), ReadFile(GetParam() + "_ast"));
+}
+
+INSTANTIATE_TEST_SUITE_P(AstFixtures, AstSerializerTest,
+                         ::testing::ValuesIn(kAstFixtures));
+
+}
@@ -0,0 +1,78 @@
+#include <memory>
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "error.hh"
+#include "scanner.hh"
+#include "file_manager.hh"
+#include "preprocessor.hh"
+#include "dep_scanner.hh"
+
+namespace axcc {
+
+TEST(MinimizeSourceTest, MinimizeSource) {
+    // Only directive lines are kept. Comments are removed and line
+    // continuations are joined.
+    EXPECT_EQ(MinimizeSource(
+                  "// comment\n"
+                  "#define A 1 /* comment */\n"
+                  "int x;\n"
+                  "  #  if A\n"
+                  "char* s = \"#not_a_directive\";\n"
+                  "/* #include \"file_not_exist\" */\n"
+                  "#endif\n"
+                  "#define B \\\n"
+                  "2\n"),
+              "#define A 1\n"
+              "#if A\n"
+              "#endif\n"
+              "#define B 2\n");
+    EXPECT_EQ(MinimizeSource("int x;\n"), "");
+    EXPECT_EQ(MinimizeSource(ReadFile("deps_include1.h")),
+              "#ifndef DEPS_INCLUDE1\n"
+              "#define DEPS_INCLUDE1\n"
+              "#define DEPS_VERSION 2\n"
+              "#endif\n");
+}
+
+TEST(DepScannerTest, Scan) {
+    DepScanner ds{FileManager::Instance(), std::list<std::string>{}};
+    std::vector<std::string> deps{
+        "deps_include1.h", "deps_include2.h", "deps_include3.h",
+        "deps_include4.h"};
+    EXPECT_EQ(ds.Scan("deps.c"), deps);
+    EXPECT_TRUE(ds.Scan("testfile1.c").empty());
+}
+
+TEST(DepScannerTest, MatchPreprocessor) {
+    // The include set should be the same as the one a full Preprocess()
+    // visits, also with computed includes, #line and failing directives.
+    std::stringstream diag_buf;
+    DiagEngine::Instance().SetOutput(diag_buf);
+    for (const std::string fname : {"deps.c", "directives.c"}) {
+        DiagEngine::Instance().Reset();
+        auto filep = FileManager::Instance().GetFile(fname);
+        EXPECT_NE(filep, nullptr) << fname << " not found";
+        if (!filep)
+            continue;
+        Scanner scanner{fname, filep->Content()};
+        auto tsp = scanner.Scan();
+        Preprocessor pp{*tsp, FileManager::Instance(),
+                        std::list<std::string>{}};
+        pp.Preprocess();
+        DepScanner ds{FileManager::Instance(), std::list<std::string>{}};
+        EXPECT_EQ(ds.Scan(fname), pp.IncludedFiles()) << fname;
+    }
+    DiagEngine::Instance().SetOutput(std::cerr);
+}
+
+TEST(DepScannerTest, PrintDeps) {
+    DepScanner ds{FileManager::Instance(), std::list<std::string>{}};
+    std::stringstream output_buf;
+    ds.PrintDeps(output_buf, "deps.o", "deps.c");
+    EXPECT_EQ(output_buf.str(),
+              "deps.o: deps.c deps_include1.h deps_include2.h "
+              "deps_include3.h deps_include4.h\n");
+}
+
+}
@@ -0,0 +1,132 @@
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "token.hh"
+#include "error.hh"
+
+namespace axcc {
+
+class DiagEngineTest : public ::testing::Test {
+protected:
+    DiagEngineTest() : fname_{"testname"},
+                       fcontent_{"testcontent line1\ntestcontent line2"},
+                       loc1_{&fname_, 1, 1, fcontent_.cbegin(), 17},
+                       loc2_{&fname_, 2, 13,
+                             std::next(fcontent_.cbegin(), 18), 17} {
+        TurnOffColorOutput();
+        engine_.SetOutput(output_buf_);
+    }
+
+    const std::string fname_;
+    const std::string fcontent_;
+    const SourceLoc loc1_;
+    const SourceLoc loc2_;
+    std::stringstream output_buf_{};
+    DiagEngine engine_{};
+};
+
+TEST_F(DiagEngineTest, Format) {
+    engine_.Report(DiagLevel::ERROR, "error message", loc1_);
+    engine_.Report(DiagLevel::WARNING, "warning message", loc2_);
+    engine_.Flush();
+    EXPECT_EQ(output_buf_.str(),
+              "Error: error message\n" + LocStr(loc1_) + "\n"
+              "Warning: warning message\n" + LocStr(loc2_) + "\n");
+    EXPECT_EQ(engine_.NumErrors(), 1);
+    EXPECT_EQ(engine_.NumWarnings(), 1);
+}
+
+TEST_F(DiagEngineTest, Duplicates) {
+    engine_.Report(DiagLevel::ERROR, "error message", loc1_);
+    engine_.Report(DiagLevel::ERROR, "error message", loc1_);
+    // Same message at another location is not a duplicate.
+    engine_.Report(DiagLevel::ERROR, "error message", loc2_);
+    engine_.Flush();
+    EXPECT_EQ(output_buf_.str(),
+              "Error: error message\n" + LocStr(loc1_) + "\n"
+              "Error: error message\n" + LocStr(loc2_) + "\n");
+    EXPECT_EQ(engine_.NumErrors(), 2);
+}
+
+TEST_F(DiagEngineTest, ErrorLimit) {
+    engine_.SetErrorLimit(2);
+    engine_.Report(DiagLevel::ERROR, "error 1", loc1_);
+    engine_.Report(DiagLevel::ERROR, "error 2", loc1_);
+    engine_.Report(DiagLevel::ERROR, "error 3", loc1_);
+    // Warnings do not count towards the limit.
+    engine_.Report(DiagLevel::WARNING, "warning", loc2_);
+    engine_.Flush();
+    EXPECT_EQ(output_buf_.str(),
+              "Error: error 1\n" + LocStr(loc1_) + "\n"
+              "Error: error 2\n" + LocStr(loc1_) + "\n"
+              "Warning: warning\n" + LocStr(loc2_) + "\n");
+    EXPECT_TRUE(engine_.ErrorLimitReached());
+}
+
+TEST_F(DiagEngineTest, DroppedNotRendered) {
+    // Only emitted diagnostics have their location rendered.
+    engine_.SetErrorLimit(1);
+    engine_.Report(DiagLevel::ERROR, "error 1", loc1_);
+    engine_.Report(DiagLevel::ERROR, "error 1", loc1_);
+    engine_.Report(DiagLevel::ERROR, "error 2", loc2_);
+    engine_.Flush();
+    EXPECT_EQ(output_buf_.str(), "Error: error 1\n" + LocStr(loc1_) + "\n");
+    EXPECT_EQ(engine_.NumRenderedLocs(), 1);
+}
+
+TEST_F(DiagEngineTest, Reset) {
+    // There is no error limit by default.
+    for (int i = 0; i < 5000; ++i)
+        engine_.Report(DiagLevel::ERROR, "error " + std::to_string(i), loc1_);
+    EXPECT_FALSE(engine_.ErrorLimitReached());
+    EXPECT_EQ(engine_.NumErrors(), 5000);
+
+    engine_.SetErrorLimit(1);
+    engine_.Report(DiagLevel::ERROR, "error", loc1_);
+    engine_.Report(DiagLevel::WARNING, "warning", loc2_);
+    EXPECT_TRUE(engine_.ErrorLimitReached());
+    // A new translation unit starts with no counts, no duplicates and the
+    // limit latch cleared. The output and the limit itself are kept.
+    engine_.Reset();
+    EXPECT_EQ(engine_.NumErrors(), 0);
+    EXPECT_EQ(engine_.NumWarnings(), 0);
+    EXPECT_FALSE(engine_.ErrorLimitReached());
+    output_buf_.str("");
+    engine_.Report(DiagLevel::ERROR, "error", loc1_);
+    engine_.Report(DiagLevel::WARNING, "warning", loc2_);
+    engine_.Report(DiagLevel::ERROR, "error 2", loc1_);
+    engine_.Flush();
+    EXPECT_EQ(output_buf_.str(),
+              "Error: error\n" + LocStr(loc1_) + "\n"
+              "Warning: warning\n" + LocStr(loc2_) + "\n");
+    EXPECT_EQ(engine_.NumErrors(), 1);
+    EXPECT_EQ(engine_.NumWarnings(), 1);
+    EXPECT_TRUE(engine_.ErrorLimitReached());
+}
+
+TEST_F(DiagEngineTest, ThreadBuffers) {
+    // Diagnostics from each thread are buffered and merged by the order
+    // key of the work that produced them, whichever thread finishes first.
+    std::thread t1{[this]() {
+        engine_.SetOrderKey(1);
+        engine_.Report(DiagLevel::ERROR, "decl 1 error 1", loc2_);
+        engine_.Report(DiagLevel::ERROR, "decl 1 error 2", loc1_);
+    }};
+    std::thread t0{[this]() {
+        engine_.SetOrderKey(0);
+        engine_.Report(DiagLevel::WARNING, "decl 0 warning", loc2_);
+    }};
+    t1.join();
+    t0.join();
+    EXPECT_EQ(output_buf_.str(), "");
+    engine_.Flush();
+    EXPECT_EQ(output_buf_.str(),
+              "Warning: decl 0 warning\n" + LocStr(loc2_) + "\n"
+              "Error: decl 1 error 1\n" + LocStr(loc2_) + "\n"
+              "Error: decl 1 error 2\n" + LocStr(loc1_) + "\n");
+    EXPECT_EQ(engine_.NumErrors(), 2);
+}
+
+}
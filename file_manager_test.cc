@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "gtest/gtest.h"
+#include "scanner.hh"
+#include "file_manager.hh"
+
+namespace axcc {
+
+TEST(FileManagerTest, GetFile) {
+    FileManager fm{};
+    auto fp = fm.GetFile("testfile1.c");
+    ASSERT_NE(fp, nullptr);
+    EXPECT_EQ(fp->Name(), "testfile1.c");
+    EXPECT_EQ(fp->Content(), ReadFile("testfile1.c"));
+    // It should only return regular files.
+    EXPECT_EQ(fm.GetFile("file_not_exist"), nullptr);
+    EXPECT_EQ(fm.GetFile("../testfiles"), nullptr);
+}
+
+TEST(FileManagerTest, SharedContents) {
+    FileManager fm{};
+    auto fp1 = fm.GetFile("testfile1.c");
+    auto fp2 = fm.GetFile("testfile1.c");
+    EXPECT_EQ(fp1, fp2);
+    // Different paths to the same file share one entry.
+    auto fp3 = fm.GetFile("./testfile1.c");
+    auto fp4 = fm.GetFile("../testfiles/testfile1.c");
+    EXPECT_EQ(&fp1->Content(), &fp3->Content());
+    EXPECT_EQ(&fp1->Content(), &fp4->Content());
+    // The entry keeps the path it was first looked up by, so callers that
+    // report locations should use the path they asked for instead.
+    EXPECT_EQ(fp3->Name(), "testfile1.c");
+    EXPECT_EQ(fp4->Name(), "testfile1.c");
+    EXPECT_EQ(fm.NumEntries(), 1);
+    EXPECT_EQ(fm.MemUsage(), fp1->Content().size());
+    auto fp5 = fm.GetFile("testfile2.c");
+    EXPECT_NE(&fp1->Content(), &fp5->Content());
+    EXPECT_EQ(fm.NumEntries(), 2);
+}
+
+TEST(FileManagerTest, ModifiedFile) {
+    const std::string fname{::testing::TempDir() + "file_manager_mtime.c"};
+    std::ofstream{fname} << "int a;\n";
+    FileManager fm{};
+    auto fp1 = fm.GetFile(fname);
+    ASSERT_NE(fp1, nullptr);
+    EXPECT_EQ(fp1->Content(), "int a;\n");
+    // Rewrite the file in place, so the inode stays the same, and move its
+    // mtime forward in case timestamps are coarse.
+    std::ofstream{fname} << "int b;\n";
+    struct stat st{};
+    ASSERT_EQ(stat(fname.c_str(), &st), 0);
+    struct timeval times[2]{{st.st_atime, 0}, {st.st_mtime + 10, 0}};
+    ASSERT_EQ(utimes(fname.c_str(), times), 0);
+    auto fp2 = fm.GetFile(fname);
+    std::remove(fname.c_str());
+    ASSERT_NE(fp2, nullptr);
+    EXPECT_EQ(fp2->Content(), "int b;\n");
+    // Holders of the stale entry still see the old contents.
+    EXPECT_EQ(fp1->Content(), "int a;\n");
+}
+
+TEST(FileManagerTest, Eviction) {
+    FileManager fm{};
+    auto fp1 = fm.GetFile("testfile1.c");
+    std::size_t size1 = fp1->Content().size();
+    // Released entries stay cached while within the memory budget.
+    fp1.reset();
+    EXPECT_EQ(fm.NumEntries(), 1);
+    EXPECT_EQ(fm.MemUsage(), size1);
+
+    // Entries that are still referenced are never evicted.
+    fp1 = fm.GetFile("testfile1.c");
+    fm.SetMemBudget(0);
+    EXPECT_EQ(fm.MemUsage(), size1);
+    auto fp2 = fm.GetFile("testfile2.c");
+    EXPECT_EQ(fm.MemUsage(), size1 + fp2->Content().size());
+    EXPECT_EQ(fp1->Content(), ReadFile("testfile1.c"));
+
+    // Released entries are evicted once over the budget.
+    fp1.reset();
+    fp2.reset();
+    fm.SetMemBudget(size1);
+    EXPECT_LE(fm.MemUsage(), size1);
+    fm.SetMemBudget(0);
+    EXPECT_EQ(fm.MemUsage(), 0);
+    EXPECT_EQ(fm.NumEntries(), 0);
+}
+
+TEST(FileManagerTest, ConcurrentLookup) {
+    FileManager fm{};
+    std::vector<std::shared_ptr<const FileEntry>> entries(8);
+    std::vector<std::thread> threads{};
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        threads.emplace_back([&fm, &entries, i]() {
+            entries[i] = fm.GetFile(i % 2 ? "testfile1.c" : "testfile2.c");
+        });
+    for (auto& t : threads)
+        t.join();
+    for (std::size_t i = 2; i < entries.size(); ++i)
+        EXPECT_EQ(entries[i], entries[i % 2]);
+    EXPECT_EQ(fm.NumEntries(), 2);
+}
+
+TEST(FileManagerTest, ProcessWideInstance) {
+    auto fp1 = FileManager::Instance().GetFile("testfile1.c");
+    auto fp2 = FileManager::Instance().GetFile("testfile1.c");
+    EXPECT_EQ(fp1, fp2);
+}
+
+}
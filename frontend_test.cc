@@ -0,0 +1,170 @@
+#include <memory>
+#include <iostream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "error.hh"
+#include "scanner.hh"
+#include "file_manager.hh"
+#include "preprocessor.hh"
+#include "parser.hh"
+#include "frontend.hh"
+
+namespace axcc {
+
+class FrontEndTest : public ::testing::Test {
+protected:
+    FrontEndTest() {
+        TurnOffColorOutput();
+        // Capture diagnostics so errors can be compared too.
+        DiagEngine::Instance().SetOutput(cerr_buf_);
+    }
+    ~FrontEndTest() {
+        // Send diagnostics to std::cerr again.
+        DiagEngine::Instance().SetOutput(std::cerr);
+    }
+    void InitFrontEnd(const std::string& src) {
+        src_ = src;
+        fep_ = std::make_unique<FrontEnd>(fname_, src_,
+                                          FileManager::Instance(),
+                                          std::list<std::string>{});
+    }
+    // Apply the same edit to our copy of the source and to the front end.
+    void Edit(const std::string& from, const std::string& to) {
+        auto pos = src_.find(from);
+        ASSERT_NE(pos, std::string::npos);
+        src_.replace(pos, from.size(), to);
+        fep_->Edit(pos, from.size(), to);
+    }
+    // Return the printed AST followed by the errors. Every parse starts a
+    // new set of diagnostics, even if the front end reuses declarations.
+    std::string Parse() {
+        cerr_buf_.str("");
+        DiagEngine::Instance().Reset();
+        std::stringstream output_buf;
+        fep_->Parse().Print(output_buf);
+        return output_buf.str() + cerr_buf_.str();
+    }
+    std::string Reparse() {
+        cerr_buf_.str("");
+        DiagEngine::Instance().Reset();
+        std::stringstream output_buf;
+        fep_->Reparse().Print(output_buf);
+        return output_buf.str() + cerr_buf_.str();
+    }
+    std::string ParseFromScratch() {
+        cerr_buf_.str("");
+        DiagEngine::Instance().Reset();
+        Scanner scanner{fname_, src_};
+        auto tsp = scanner.Scan();
+        Preprocessor pp{*tsp, FileManager::Instance(),
+                        std::list<std::string>{}};
+        pp.Preprocess();
+        Parser parser{*tsp};
+        std::stringstream output_buf;
+        parser.Parse().Print(output_buf);
+        return output_buf.str() + cerr_buf_.str();
+    }
+
+    const std::string fname_{"incremental.c"};
+    std::string src_{};
+    std::unique_ptr<FrontEnd> fep_{};
+    std::stringstream cerr_buf_{};
+};
+
+TEST_F(FrontEndTest, Reparse) {
+    InitFrontEnd("int g1 = 1;\n"
+                 "int f1(int a) {\n"
+                 "    return a + g1;\n"
+                 "}\n"
+                 "int f2(int a) {\n"
+                 "    return a * 2;\n"
+                 "}\n"
+                 "int f3() {\n"
+                 "    return f2(3);\n"
+                 "}\n");
+    EXPECT_EQ(Parse(), ParseFromScratch());
+    // Nothing changed.
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    EXPECT_EQ(fep_->NumReparsedDecls(), 0);
+    // Edit inside a function body.
+    Edit("a * 2", "a * 4");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    EXPECT_EQ(fep_->NumReparsedDecls(), 1);
+    // Insert a new declaration.
+    Edit("int f3()", "int g2 = 2;\nint f3()");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    EXPECT_EQ(fep_->NumReparsedDecls(), 1);
+    // Introduce an error.
+    Edit("a + g1", "a + g3");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    // Fix it again.
+    Edit("a + g3", "a + g1");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    // Change the type of a declaration that later ones refer to.
+    Edit("int g1 = 1;", "long g1 = 1;");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    // Remove a declaration.
+    Edit("int g2 = 2;\n", "");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+}
+
+TEST_F(FrontEndTest, ReparseShiftedDiagnostics) {
+    InitFrontEnd("int g1 = 1;\n"
+                 "int f1(int a) {\n"
+                 "    return a + undecl;\n"
+                 "}\n"
+                 "int f2(int a) {\n"
+                 "    return a;\n"
+                 "}\n");
+    EXPECT_EQ(Parse(), ParseFromScratch());
+    // Lines inserted above f1 move its diagnostic without changing it.
+    Edit("int g1 = 1;\n", "int g1 = 1;\n// Comment.\n\n");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    EXPECT_EQ(fep_->NumReparsedDecls(), 0);
+    Edit("int g1 = 1;\n", "int g1 = 1;\nint g0 = 0;\n");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    EXPECT_EQ(fep_->NumReparsedDecls(), 1);
+    // Also above every declaration, and on the line of the error itself.
+    Edit("int g1 = 1;\n", "\n\nint g1 = 1;\n");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    Edit("    return a + undecl;", "    return  a +  undecl;");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+}
+
+TEST_F(FrontEndTest, ReparseMacros) {
+    InitFrontEnd("#define K 2\n"
+                 "int f1(int a) {\n"
+                 "    return a * K;\n"
+                 "}\n"
+                 "int f2(int a) {\n"
+                 "    return a;\n"
+                 "}\n");
+    EXPECT_EQ(Parse(), ParseFromScratch());
+    // The tokens of f1 are unchanged but its preprocessing context is not.
+    Edit("#define K 2", "#define K 5");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    EXPECT_EQ(fep_->NumReparsedDecls(), 1);
+    Edit("#define K 5", "#define K (");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+    Edit("#define K (", "#define K 3");
+    EXPECT_EQ(Reparse(), ParseFromScratch());
+}
+
+TEST_F(FrontEndTest, ReparseEditSequence) {
+    std::string src{};
+    for (int i = 0; i < 200; ++i)
+        src += "int f" + std::to_string(i) + "(int a) {\n"
+               "    return a + " + std::to_string(i) + ";\n}\n";
+    InitFrontEnd(src);
+    EXPECT_EQ(Parse(), ParseFromScratch());
+    // Edit one body at a time from the end to the beginning.
+    for (int i = 199; i >= 0; i -= 17) {
+        Edit("return a + " + std::to_string(i) + ";",
+             "return a - " + std::to_string(i) + ";");
+        EXPECT_EQ(Reparse(), ParseFromScratch());
+        EXPECT_EQ(fep_->NumReparsedDecls(), 1);
+    }
+}
+
+}
@@ -1,45 +1,112 @@
+#include <algorithm>
 #include <memory>
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <vector>
+#include <pthread.h>
+#include <dirent.h>
 
 #include "gtest/gtest.h"
 #include "error.hh"
 #include "scanner.hh"
+#include "file_manager.hh"
 #include "preprocessor.hh"
+#include "ast.hh"
 #include "parser.hh"
+#include "ast_fixtures.hh"
 
 namespace axcc {
 
 class ParserTest : public ::testing::Test {
 protected:
     ~ParserTest() {
-        // Set the original buffer to std::cerr.
+        // Set the original buffer to std::cout and send diagnostics to
+        // std::cerr again.
         std::cout.rdbuf(orig_cout_buf_);
-        std::cerr.rdbuf(orig_cerr_buf_);
+        DiagEngine::Instance().SetOutput(std::cerr);
     }
     void InitParser(const std::string& fname) {
+        ResetParser();
+        filep_ = FileManager::Instance().GetFile(fname);
+        // Fall back to an empty file so a missing fixture fails this test
+        // instead of crashing the whole binary.
+        if (!filep_)
+            InitParserFromSource(fname, "");
+        ASSERT_NE(filep_, nullptr) << fname << " not found";
+        // Name diagnostics by the requested path, since the entry may have
+        // been looked up by another path to the same file first.
+        InitParser(fname, filep_->Content());
+    }
+    // Parse generated source code instead of a file in testfiles.
+    void InitParserFromSource(const std::string& fname,
+                              const std::string& src) {
+        ResetParser();
+        src_fname_ = fname;
+        src_ = src;
+        InitParser(src_fname_, src_);
+    }
+    void InitParser(const std::string& fname, const std::string& fcontent) {
+        ResetParser();
         TurnOffColorOutput();
-        auto iter = files_.emplace(fname, ReadFile(fname)).first;
-        Scanner scanner{iter->first, iter->second};
+        Scanner scanner{fname, fcontent};
         tsp_ = scanner.Scan();
-        Preprocessor pp{*tsp_, files_, std::list<std::string>{}};
+        Preprocessor pp{*tsp_, FileManager::Instance(),
+                        std::list<std::string>{}};
         pp.Preprocess();
         parserp_ = std::make_unique<Parser>(*tsp_);
-        // Capture std::cerr and std::cout to check the output.
-        orig_cout_buf_ = std::cout.rdbuf(cout_buf_.rdbuf());
-        orig_cerr_buf_ = std::cerr.rdbuf(cerr_buf_.rdbuf());
+        // Capture std::cout and the diagnostics to check the output. Output
+        // of the previous run is dropped if the parser is initialized again.
+        cout_buf_.str("");
+        cerr_buf_.str("");
+        if (!orig_cout_buf_)
+            orig_cout_buf_ = std::cout.rdbuf(cout_buf_.rdbuf());
+        DiagEngine::Instance().SetOutput(cerr_buf_);
+        // Each parse is a new translation unit, so diagnostics of an
+        // earlier one must not suppress or count towards its own.
+        DiagEngine::Instance().Reset();
+    }
+
+    // Destroy the parser of the previous run before the tokens and the
+    // source it refers to.
+    void ResetParser() {
+        parserp_.reset();
+        tsp_.reset();
     }
 
-    std::map<std::string, std::string> files_{};
+    std::shared_ptr<const FileEntry> filep_{};
+    std::string src_fname_{};
+    std::string src_{};
     std::unique_ptr<TokenSequence> tsp_{};
     std::unique_ptr<Parser> parserp_{};
     std::stringstream cout_buf_{};
     std::stringstream cerr_buf_{};
     std::streambuf *orig_cout_buf_{};
-    std::streambuf *orig_cerr_buf_{};
 };
 
+std::size_t CountSubstr(const std::string& str, const std::string& sub) {
+    std::size_t count = 0;
+    for (auto pos = str.find(sub); pos != std::string::npos;
+         pos = str.find(sub, pos + sub.size()))
+        ++count;
+    return count;
+}
+
+// Count the nodes of each kind in the printed AST.
+std::map<std::string, int> CountKinds(const std::string& ast) {
+    std::map<std::string, int> counts{};
+    std::istringstream ast_buf{ast};
+    std::string kind;
+    // The first word of each line is the kind of the node.
+    for (std::string line; std::getline(ast_buf, line);) {
+        std::istringstream{line} >> kind;
+        ++counts[kind];
+    }
+    return counts;
+}
+
 TEST_F(ParserTest, ObjectDecls) {
     InitParser("obj_decls.c");
     parserp_->Parse().Print(std::cout);
@@ -103,4 +170,707 @@ TEST_F(ParserTest, Expressions) {
     EXPECT_EQ(cout_buf_.str(), ReadFile("expressions_ast"));
 }
 
+TEST_F(ParserTest, Precedence) {
+    InitParser("precedence.c");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), ReadFile("precedence_errs"));
+    EXPECT_EQ(cout_buf_.str(), ReadFile("precedence_ast"));
+}
+
+TEST_F(ParserTest, ConstantFolding) {
+    InitParser("const_folding.c");
+    parserp_->SetFoldConstants(true);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), ReadFile("const_folding_errs"));
+    EXPECT_EQ(cout_buf_.str(), ReadFile("const_folding_ast"));
+
+    // The warnings come from folding. Without it these are not constant
+    // expressions, so the default parser still reports nothing for them.
+    InitParser("const_folding.c");
+    parserp_->SetFoldConstants(false);
+    parserp_->Parse();
+    EXPECT_EQ(cerr_buf_.str(), "");
+}
+
+TEST_F(ParserTest, InternedTypes) {
+    InitParser("interned_types.c");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), ReadFile("interned_types_errs"));
+    EXPECT_EQ(cout_buf_.str(), ReadFile("interned_types_ast"));
+}
+
+TEST_F(ParserTest, InternedTypeTable) {
+    // Repeating the same derived types must not grow the type table.
+    auto make_src = [](int n) {
+        std::string src{"struct S { int m; };\nvoid f() {\n"};
+        for (int i = 0; i < n; ++i) {
+            std::string num = std::to_string(i);
+            src += "    int* p" + num + ";\n"
+                   "    int (*pf" + num + ")(int, int);\n"
+                   "    int a" + num + "[3][4];\n"
+                   "    const int* cp" + num + ";\n"
+                   "    struct S* ps" + num + ";\n";
+        }
+        return src + "}\n";
+    };
+    InitParserFromSource("types_once.c", make_src(1));
+    parserp_->Parse();
+    EXPECT_EQ(cerr_buf_.str(), "");
+    std::size_t num_types = parserp_->Types().Size();
+    InitParserFromSource("types_repeated.c", make_src(1000));
+    parserp_->Parse();
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(parserp_->Types().Size(), num_types);
+}
+
+// Count the nodes in the printed AST. Initializer lines only list the
+// offset of the expression under them.
+int CountNodes(const std::string& ast) {
+    auto counts = CountKinds(ast);
+    int num_nodes = 0;
+    for (const auto& count : counts)
+        num_nodes += count.second;
+    return num_nodes - counts["Initializer"];
+}
+
+TEST_F(ParserTest, NodeArena) {
+    InitParser("expressions.c");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cout_buf_.str(), ReadFile("expressions_ast"));
+    // All nodes of the translation unit come from one arena.
+    ArenaStats stats = parserp_->NodeArenaStats();
+    EXPECT_GE(stats.num_nodes, CountNodes(ReadFile("expressions_ast")));
+    EXPECT_GT(stats.num_blocks, 0);
+    EXPECT_GT(stats.bytes_used, 0);
+    EXPECT_GE(stats.bytes_allocated, stats.bytes_used);
+
+    // Every node added to the tree is allocated from the arena.
+    auto make_src = [](int n) {
+        std::string src{"void f(int a) {\n"};
+        for (int i = 0; i < n; ++i)
+            src += "    a = a + " + std::to_string(i) + ";\n";
+        return src + "}\n";
+    };
+    InitParserFromSource("arena_small.c", make_src(1000));
+    parserp_->Parse().Print(std::cout);
+    int small_nodes = CountNodes(cout_buf_.str());
+    stats = parserp_->NodeArenaStats();
+    InitParserFromSource("arena_large.c", make_src(3000));
+    parserp_->Parse().Print(std::cout);
+    int large_nodes = CountNodes(cout_buf_.str());
+    // Each statement is an ExprStmt with two BinaryExprs, two Identifiers
+    // and a Constant.
+    EXPECT_EQ(large_nodes - small_nodes, 2000 * 6);
+    const ArenaStats& large_stats = parserp_->NodeArenaStats();
+    EXPECT_EQ(large_stats.num_nodes - stats.num_nodes,
+              large_nodes - small_nodes);
+    EXPECT_GT(large_stats.bytes_used, stats.bytes_used);
+    EXPECT_GE(large_stats.bytes_allocated, large_stats.bytes_used);
+}
+
+TEST_F(ParserTest, ManyIdentifiers) {
+    // Lookups should not depend on the number of globals or locals.
+    std::string src{};
+    for (int i = 0; i < 100000; ++i)
+        src += "int g" + std::to_string(i) + " = " + std::to_string(i) +
+               ";\n";
+    src += "void f() {\n";
+    for (int i = 0; i < 20000; ++i)
+        src += "    int l" + std::to_string(i) + " = g" +
+               std::to_string(i * 5) + ";\n";
+    // Shadowed in an inner scope and visible again after it.
+    src += "    {\n        long l0;\n        l0;\n    }\n    l0;\n}\n";
+    InitParserFromSource("many_idents.c", src);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "ObjDefStmt 'int' g"), 100000);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Identifier 'int' g"), 20000);
+    EXPECT_NE(cout_buf_.str().find(
+                  "      ExprStmt\n        Identifier 'long' l0\n"),
+              std::string::npos);
+    EXPECT_NE(cout_buf_.str().find(
+                  "    ExprStmt\n      Identifier 'int' l0\n"),
+              std::string::npos);
+}
+
+TEST_F(ParserTest, LazyFuncBodies) {
+    InitParser("statements.c");
+    parserp_->SetLazyFuncBodies(true);
+    auto& tu = parserp_->Parse();
+    // Bodies are only skimmed, so errors in them are not reported yet.
+    EXPECT_EQ(parserp_->NumParsedFuncBodies(), 0);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    // Printing asks for the bodies, which parses them on demand.
+    tu.Print(std::cout);
+    EXPECT_EQ(parserp_->NumParsedFuncBodies(), 1);
+    EXPECT_EQ(cerr_buf_.str(), ReadFile("statements_errs"));
+    EXPECT_EQ(cout_buf_.str(), ReadFile("statements_ast"));
+
+    // A body parsed on demand must not see declarations that follow it,
+    // even though the whole translation unit is known by then.
+    const std::string src{"int f(void) {\n"
+                          "    return later_g;\n"
+                          "}\n"
+                          "int later_g = 1;\n"
+                          "int g(void) {\n"
+                          "    return later_g;\n"
+                          "}\n"};
+    InitParserFromSource("later_decl.c", src);
+    parserp_->Parse().Print(std::cout);
+    std::string eager_out = cout_buf_.str();
+    std::string eager_errs = cerr_buf_.str();
+    EXPECT_EQ(CountSubstr(eager_errs,
+                          "use of undeclared identifier 'later_g'"), 1);
+    InitParserFromSource("later_decl.c", src);
+    parserp_->SetLazyFuncBodies(true);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(parserp_->NumParsedFuncBodies(), 2);
+    EXPECT_EQ(cerr_buf_.str(), eager_errs);
+    EXPECT_EQ(cout_buf_.str(), eager_out);
+}
+
+TEST_F(ParserTest, ParallelFuncBodiesOrder) {
+    // Each function body reports one error.
+    std::string src{};
+    for (int i = 0; i < 2000; ++i) {
+        src += "int f" + std::to_string(i) + "(int a) {\n"
+               "    int l = a * " + std::to_string(i) + ";\n"
+               "    return undecl" + std::to_string(i) + ";\n}\n";
+        if (i != 1000)
+            continue;
+        // Bodies only see what is declared before them, not the global
+        // scope at the end of the translation unit.
+        src += "int early(void) {\n"
+               "    int n = sizeof(struct Later);\n"
+               "    Later_t t;\n"
+               "    return later_g;\n}\n"
+               "struct Later { int m; };\n"
+               "typedef int Later_t;\n"
+               "int later_g = 1;\n"
+               "int late(void) {\n"
+               "    Later_t t = sizeof(struct Later);\n"
+               "    return later_g + t;\n}\n";
+    }
+    InitParserFromSource("many_funcs.c", src);
+    parserp_->Parse().Print(std::cout);
+    std::string serial_out = cout_buf_.str();
+    std::string serial_errs = cerr_buf_.str();
+    EXPECT_EQ(CountSubstr(serial_errs,
+                          "use of undeclared identifier 'undecl"), 2000);
+    // Only the use in early() is an error.
+    EXPECT_EQ(CountSubstr(serial_errs,
+                          "use of undeclared identifier 'later_g'"), 1);
+    EXPECT_EQ(serial_errs.find("return later_g + t;"), std::string::npos);
+    // All of them are reported since there is no default error limit.
+    EXPECT_FALSE(DiagEngine::Instance().ErrorLimitReached());
+
+    InitParserFromSource("many_funcs.c", src);
+    parserp_->SetParseThreads(8);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), serial_errs);
+    EXPECT_EQ(cout_buf_.str(), serial_out);
+}
+
+// Count the nodes of each kind and record the order they are visited in.
+class KindCounter : public AstVisitor {
+public:
+    // The kinds that have a Visit callback overridden below.
+    static const std::vector<std::string> kKinds;
+
+    void VisitFuncDef(const FuncDef&) override { Count("FuncDef"); }
+    void VisitCmpdStmt(const CmpdStmt&) override { Count("CmpdStmt"); }
+    void VisitIfStmt(const IfStmt&) override { Count("IfStmt"); }
+    void VisitJumpStmt(const JumpStmt&) override { Count("JumpStmt"); }
+    void VisitLabelStmt(const LabelStmt&) override { Count("LabelStmt"); }
+    void VisitReturnStmt(const ReturnStmt&) override { Count("ReturnStmt"); }
+    void VisitObjDefStmt(const ObjDefStmt&) override {
+        Count("ObjDefStmt"); }
+    void VisitTempObj(const TempObj&) override { Count("TempObj"); }
+    void VisitBinaryExpr(const BinaryExpr&) override {
+        Count("BinaryExpr"); }
+    void Merge(const KindCounter& other) {
+        for (const auto& count : other.counts_)
+            counts_[count.first] += count.second;
+        order_ += other.order_;
+    }
+
+    std::map<std::string, int> counts_{};
+    std::string order_{};
+
+private:
+    void Count(const std::string& kind) {
+        ++counts_[kind];
+        order_ += kind + "\n";
+    }
+};
+
+const std::vector<std::string> KindCounter::kKinds{
+    "FuncDef", "CmpdStmt", "IfStmt", "JumpStmt", "LabelStmt", "ReturnStmt",
+    "ObjDefStmt", "TempObj", "BinaryExpr"};
+
+class ParserFixtureTest : public ParserTest,
+                          public ::testing::WithParamInterface<std::string> {
+};
+
+TEST_P(ParserFixtureTest, ParallelFuncBodies) {
+    InitParser(GetParam() + ".c");
+    parserp_->SetParseThreads(4);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), ReadFile(GetParam() + "_errs"));
+    EXPECT_EQ(cout_buf_.str(), ReadFile(GetParam() + "_ast"));
+}
+
+TEST_P(ParserFixtureTest, BufferedPrinter) {
+    InitParser(GetParam() + ".c");
+    std::stringstream output_buf;
+    AstPrinter printer{output_buf};
+    printer.Print(parserp_->Parse());
+    printer.Flush();
+    EXPECT_EQ(output_buf.str(), ReadFile(GetParam() + "_ast"));
+}
+
+TEST_P(ParserFixtureTest, Visitor) {
+    InitParser(GetParam() + ".c");
+    auto& tu = parserp_->Parse();
+    KindCounter counter{};
+    Walk(tu, counter);
+    auto golden_counts = CountKinds(ReadFile(GetParam() + "_ast"));
+    for (const auto& kind : KindCounter::kKinds)
+        EXPECT_EQ(counter.counts_[kind], golden_counts[kind]) << kind;
+    // Only these fixtures define no functions.
+    const std::vector<std::string> no_func_defs{
+        "complicated_types", "enums", "unions"};
+    if (std::find(no_func_defs.cbegin(), no_func_defs.cend(), GetParam()) ==
+        no_func_defs.cend())
+        EXPECT_GT(counter.counts_["FuncDef"], 0);
+    // Per-thread results are merged in declaration order.
+    KindCounter merged = ParallelWalk<KindCounter>(tu, 4);
+    EXPECT_EQ(merged.counts_, counter.counts_);
+    EXPECT_EQ(merged.order_, counter.order_);
+}
+
+INSTANTIATE_TEST_SUITE_P(AstFixtures, ParserFixtureTest,
+                         ::testing::ValuesIn(kAstFixtures));
+
+TEST(AstFixturesTest, AllGoldens) {
+    // Every *_ast golden in testfiles is run by the fixture suites, except
+    // the one that needs constant folding.
+    DIR* dirp = opendir(".");
+    ASSERT_NE(dirp, nullptr);
+    std::vector<std::string> goldens{};
+    const std::string suffix{"_ast"};
+    while (dirent* entp = readdir(dirp)) {
+        std::string name{entp->d_name};
+        if (name.size() > suffix.size() &&
+            name.compare(name.size() - suffix.size(), suffix.size(),
+                         suffix) == 0)
+            goldens.push_back(name.substr(0, name.size() - suffix.size()));
+    }
+    closedir(dirp);
+    for (const auto& golden : goldens)
+        if (golden != "const_folding")
+            EXPECT_NE(std::find(kAstFixtures.cbegin(), kAstFixtures.cend(),
+                                golden),
+                      kAstFixtures.cend())
+                << golden << "_ast is missing from kAstFixtures";
+    EXPECT_EQ(goldens.size(), kAstFixtures.size() + 1);
+}
+
+TEST_F(ParserTest, LongBinaryChain) {
+    // Every level of the precedence table in one generated expression.
+    const std::vector<std::string> ops{
+        "*", "+", "<<", "<", "==", "&", "^", "|", "&&", "||"};
+    std::string expr{"a"};
+    for (int i = 0; i < 5000; ++i)
+        expr += " " + ops[i % ops.size()] + " a";
+    InitParserFromSource("binary_chain.c",
+                         "void f(int a) {\n    " + expr + ";\n}\n");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "BinaryExpr 'int'"), 5000);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Identifier 'int' a"), 5001);
+
+    // The same chain with the expected grouping spelled out. Parentheses
+    // do not create nodes, so both must print the same tree. Each run of
+    // operators up to '&&' binds tighter than the next one and groups to
+    // the left, and the runs are joined by '||'.
+    std::string group{"a"};
+    for (std::size_t i = 0; i + 1 < ops.size(); ++i)
+        group = "(" + group + " " + ops[i] + " a)";
+    std::string grouped{group};
+    for (int i = 1; i < 5000 / 10; ++i)
+        grouped = "(" + grouped + " || " + group + ")";
+    grouped = "(" + grouped + " || a)";
+    std::string chain_out = cout_buf_.str();
+    InitParserFromSource("binary_chain_grouped.c",
+                         "void f(int a) {\n    " + grouped + ";\n}\n");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(cout_buf_.str(), chain_out);
+}
+
+// Run f on a thread with a small native stack, so a stage that recurses
+// on the nesting depth overflows it.
+void RunOnSmallStack(const std::function<void()>& f) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    auto run = [](void* arg) -> void* {
+        (*static_cast<const std::function<void()>*>(arg))();
+        return nullptr;
+    };
+    ASSERT_EQ(pthread_create(&thread, &attr, run,
+                             const_cast<std::function<void()>*>(&f)), 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+}
+
+TEST_F(ParserTest, DeepNesting) {
+    RunOnSmallStack([this]() {
+        // The printed form of these is quadratic in the depth, so only parse
+        // them.
+        std::string chain{"a"};
+        for (int i = 0; i < 100000; ++i)
+            chain += " + a";
+        std::string ladder{"if (a) a = 0;"};
+        for (int i = 0; i < 20000; ++i)
+            ladder += " else if (a) a = " + std::to_string(i) + ";";
+        std::string blocks(20000, '{');
+        blocks += std::string(20000, '}');
+        InitParserFromSource("deep_nesting.c",
+                             "void f(int a) {\n    " + chain + ";\n    " +
+                             ladder + "\n    " + blocks + "\n}\n");
+        parserp_->Parse();
+        EXPECT_EQ(cerr_buf_.str(), "");
+
+        // Nested parentheses do not create nodes.
+        InitParserFromSource("deep_parens.c",
+                             "void f(int a) {\n    " +
+                             std::string(20000, '(') + "a" +
+                             std::string(20000, ')') + ";\n}\n");
+        parserp_->Parse().Print(std::cout);
+        EXPECT_EQ(cerr_buf_.str(), "");
+        EXPECT_EQ(cout_buf_.str(),
+                  "FuncDef 'void (int)' f\n"
+                  "  CmpdStmt\n"
+                  "    ExprStmt\n"
+                  "      Identifier 'int' a\n");
+
+        // The evaluator folds a long chain in a constant expression.
+        std::string const_chain{"1"};
+        for (int i = 0; i < 100000; ++i)
+            const_chain += " + 1";
+        InitParserFromSource("deep_const.c",
+                             "int g = " + const_chain + ";\n");
+        parserp_->Parse().Print(std::cout);
+        EXPECT_EQ(cerr_buf_.str(), "");
+        EXPECT_EQ(cout_buf_.str(),
+                  "ObjDefStmt 'int' g\n"
+                  "  Initializer offset: 0\n"
+                  "    Constant 'int' 100001\n");
+
+        // The printer handles deep trees too.
+        ladder = "if (a) a = 0;";
+        for (int i = 0; i < 1000; ++i)
+            ladder += " else if (a) a = " + std::to_string(i) + ";";
+        InitParserFromSource("deep_ladder.c",
+                             "void f(int a) {\n    " + ladder + "\n}\n");
+        parserp_->Parse().Print(std::cout);
+        EXPECT_EQ(cerr_buf_.str(), "");
+        EXPECT_EQ(CountSubstr(cout_buf_.str(), "IfStmt"), 1001);
+        // Destroy the AST on the small stack too.
+        ResetParser();
+    });
+}
+
+TEST_F(ParserTest, LargeArrayInitializers) {
+    // Designators into a giant zero-filled array.
+    InitParserFromSource("sparse_init.c",
+                         "int a1[4000000] = {[3999999] = 2, [0] = 1,\n"
+                         "                   [2000000] = 3, 4};\n"
+                         "int a2[4000000][4] = {[3999999][3] = 5};\n"
+                         // Later designators split a run of repeated values
+                         // and override an earlier explicit value.
+                         "int a4[8] = {7, 7, 7, 7, 7, [2] = 9, [0] = 1};\n");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(cout_buf_.str(),
+              "ObjDefStmt 'int [4000000]' a1\n"
+              "  Initializer offset: 0\n"
+              "    Constant 'int' 1\n"
+              "  Initializer offset: 8000000\n"
+              "    Constant 'int' 3\n"
+              "  Initializer offset: 8000004\n"
+              "    Constant 'int' 4\n"
+              "  Initializer offset: 15999996\n"
+              "    Constant 'int' 2\n"
+              "ObjDefStmt 'int [4000000][4]' a2\n"
+              "  Initializer offset: 63999996\n"
+              "    Constant 'int' 5\n"
+              "ObjDefStmt 'int [8]' a4\n"
+              "  Initializer offset: 0\n"
+              "    Constant 'int' 1\n"
+              "  Initializer offset: 4\n"
+              "    Constant 'int' 7\n"
+              "  Initializer offset: 8\n"
+              "    Constant 'int' 9\n"
+              "  Initializer offset: 12\n"
+              "    Constant 'int' 7\n"
+              "  Initializer offset: 16\n"
+              "    Constant 'int' 7\n");
+
+    // Runs of repeated values are still printed element by element.
+    std::string src{"int a3[] = {"};
+    for (int i = 0; i < 100000; ++i)
+        src += i < 50000 ? "7, " : "0, ";
+    src += "9};\n";
+    InitParserFromSource("repeated_init.c", src);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(cout_buf_.str().find("ObjDefStmt 'int [100001]' a3\n"), 0);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Constant 'int' 7\n"), 50000);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Constant 'int' 0\n"), 50000);
+    EXPECT_NE(cout_buf_.str().find("  Initializer offset: 400000\n"
+                                   "    Constant 'int' 9\n"),
+              std::string::npos);
+}
+
+// Return the printed StrLiteral line of the first string literal.
+std::string StrLiteralLine(const std::string& output) {
+    auto begin = output.find("StrLiteral");
+    if (begin == std::string::npos)
+        return "";
+    return output.substr(begin, output.find('\n', begin) - begin);
+}
+
+TEST_F(ParserTest, AdjacentStrLiterals) {
+    // Concatenated and escaped pieces decode to the same bytes as one
+    // plain literal.
+    InitParserFromSource("str_single.c", "char* p = \"ABC\\n\\tDEF\";\n");
+    parserp_->Parse().Print(std::cout);
+    std::string single = StrLiteralLine(cout_buf_.str());
+    EXPECT_EQ(single.find("StrLiteral 'char [9]' "), 0);
+    InitParserFromSource("str_pieces.c",
+                         "char* p = \"\\x41\" \"\\102\" \"C\\12\" "
+                         "\"\\11D\" \"\" \"EF\";\n");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(StrLiteralLine(cout_buf_.str()), single);
+
+    // Thousands of adjacent literals against one large literal.
+    std::string large(1 << 20, 'A');
+    InitParserFromSource("str_large.c", "char* p = \"" + large + "\";\n");
+    parserp_->Parse().Print(std::cout);
+    single = StrLiteralLine(cout_buf_.str());
+    EXPECT_EQ(single.find("StrLiteral 'char [1048577]' "), 0);
+    std::string pieces{};
+    for (int i = 0; i < (1 << 20) / 64; ++i)
+        pieces += "\"" + std::string(64, 'A') + "\"\n";
+    InitParserFromSource("str_large_pieces.c", "char* p = " + pieces + ";\n");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(StrLiteralLine(cout_buf_.str()), single);
+}
+
+TEST_F(ParserTest, BufferedPrinterReuse) {
+    // A small buffer forces many flushes in the middle of lines.
+    std::stringstream output_buf;
+    AstPrinter printer{output_buf, 16};
+    InitParser("expressions.c");
+    printer.Print(parserp_->Parse());
+    InitParser("structs.c");
+    printer.Print(parserp_->Parse());
+    printer.Flush();
+    EXPECT_EQ(output_buf.str(),
+              ReadFile("expressions_ast") + ReadFile("structs_ast"));
+}
+
+TEST_F(ParserTest, VisitorDeepTree) {
+    // The traversal core should not recurse on deep trees, so walk them on
+    // a stack a recursive walker would overflow.
+    std::string chain{"a"};
+    for (int i = 0; i < 100000; ++i)
+        chain += " + a";
+    std::string src{};
+    for (int i = 0; i < 16; ++i)
+        src += "int f" + std::to_string(i) + "(int a) {\n    return " +
+               chain + ";\n}\n";
+    RunOnSmallStack([this, &src]() {
+        InitParserFromSource("deep_visitor.c", src);
+        auto& tu = parserp_->Parse();
+        KindCounter counter{};
+        Walk(tu, counter);
+        EXPECT_EQ(counter.counts_["FuncDef"], 16);
+        EXPECT_EQ(counter.counts_["BinaryExpr"], 1600000);
+        // The worker threads get the same small stack.
+        KindCounter merged = ParallelWalk<KindCounter>(tu, 4, 256 * 1024);
+        EXPECT_EQ(merged.counts_, counter.counts_);
+        EXPECT_EQ(merged.order_, counter.order_);
+        // Destroy the AST on the small stack too.
+        ResetParser();
+    });
+}
+
+TEST_F(ParserTest, ManyGenericAssociations) {
+    std::string src{};
+    for (int i = 0; i < 500; ++i)
+        src += "struct S" + std::to_string(i) + " { int m" +
+               std::to_string(i) + "; };\n";
+    std::string assocs{};
+    for (int i = 0; i < 500; ++i)
+        assocs += "struct S" + std::to_string(i) + ": " + std::to_string(i) +
+                  ", int (*)[" + std::to_string(i + 1) + "]: " +
+                  std::to_string(i + 1000) + ", ";
+    assocs += "default: -1";
+    // Repeated redeclarations need the same compatibility checks again.
+    for (int i = 0; i < 1000; ++i)
+        src += "int g(struct S321, int (*)[322]);\n";
+    src += "void f(struct S321 s, int (*p)[322]) {\n";
+    for (int i = 0; i < 200; ++i)
+        src += "    _Generic(s, " + assocs + ");\n"
+               "    _Generic(p, " + assocs + ");\n";
+    src += "}\n";
+    InitParserFromSource("generic_assocs.c", src);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Constant 'int' 321\n"), 200);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Constant 'int' 1321\n"), 200);
+}
+
+TEST_F(ParserTest, LargeRecords) {
+    // A struct with 5000 members and a 50-deep anonymous member.
+    std::string src{"struct Big {\n"};
+    for (int i = 0; i < 5000; ++i)
+        src += "    int m" + std::to_string(i) + ";\n";
+    for (int i = 0; i < 50; ++i)
+        src += "    struct {\n";
+    src += "    int deep;\n";
+    for (int i = 0; i < 50; ++i)
+        src += "    };\n";
+    src += "};\n"
+           "_Static_assert(sizeof(struct Big) == 20004, \"incorrect size\");\n"
+           "struct Big b = {.m4999 = 1, .deep = 2};\n"
+           "void f() {\n";
+    for (int i = 4999; i >= 0; --i)
+        src += "    b.m" + std::to_string(i) + " = 3;\n";
+    src += "    b.deep = 4;\n}\n";
+    InitParserFromSource("large_records.c", src);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(cout_buf_.str().find("ObjDefStmt 'struct Big' b\n"
+                                   "  Initializer offset: 19996\n"
+                                   "    Constant 'int' 1\n"
+                                   "  Initializer offset: 20000\n"
+                                   "    Constant 'int' 2\n"
+                                   "FuncDef 'void ()' f\n"), 0);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "Identifier 'int' m"), 5000);
+    EXPECT_NE(cout_buf_.str().find("        BinaryExpr 'int' '.'\n"
+                                   "          Identifier 'struct Big' b\n"
+                                   "          Identifier 'int' deep\n"),
+              std::string::npos);
+}
+
+TEST_F(ParserTest, LargeEnums) {
+    // Values are computed from earlier enumerators.
+    std::string src{"enum E {\n    E0,\n"};
+    for (int i = 1; i < 20000; ++i)
+        src += "    E" + std::to_string(i) + " = E" +
+               std::to_string(i % 100 ? i - 1 : i - 50) + " + " +
+               std::to_string(i % 100 ? 1 : 50) + ",\n";
+    src += "};\n"
+           "int a[E1000];\n";
+    std::string expected{};
+    for (int i = 0; i < 1000; ++i) {
+        src += "int g" + std::to_string(i) + " = E" +
+               std::to_string(i * 20) + " + 1;\n";
+        expected += "ObjDefStmt 'int' g" + std::to_string(i) + "\n"
+                    "  Initializer offset: 0\n"
+                    "    Constant 'int' " + std::to_string(i * 20 + 1) + "\n";
+    }
+    expected += "ObjDefStmt 'int [1000]' a\n";
+    InitParserFromSource("large_enums.c", src);
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(cout_buf_.str(), expected);
+}
+
+TEST_F(ParserTest, ManyLabels) {
+    // Forward and backward gotos among thousands of labels.
+    std::string body{"    goto L4999;\n"};
+    for (int i = 0; i < 5000; ++i)
+        body += "L" + std::to_string(i) + ": if (a) goto L" +
+                std::to_string(i * 7919 % 5000) + ";\n";
+    InitParserFromSource("many_labels.c",
+                         "void f(int a) {\n" + body + "}\n");
+    parserp_->Parse().Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "LabelStmt L"), 5000);
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "JumpStmt L"), 5001);
+
+    // Duplicate and undeclared labels are reported once each.
+    InitParserFromSource("bad_labels.c",
+                         "void f(int a) {\n" + body +
+                         "L2500: goto undecl_label;\n}\n");
+    parserp_->Parse();
+    EXPECT_EQ(CountSubstr(cerr_buf_.str(), "Error: "), 2);
+    EXPECT_NE(cerr_buf_.str().find("'L2500'"), std::string::npos);
+    EXPECT_NE(cerr_buf_.str().find("use of undeclared label 'undecl_label'"),
+              std::string::npos);
+}
+
+// Collect the case table of every switch statement.
+class SwitchCollector : public AstVisitor {
+public:
+    void VisitSwitchStmt(const SwitchStmt& stmt) override {
+        tables_.push_back(&stmt.Cases());
+    }
+
+    std::vector<const CaseTable *> tables_{};
+};
+
+TEST_F(ParserTest, LargeSwitch) {
+    // Case values are constant expressions evaluated once each. They are
+    // emitted out of order so the table has to be sorted.
+    std::string cases{};
+    for (int i = 0; i < 10000; ++i) {
+        int j = i * 7919 % 10000;
+        cases += "    case " + std::to_string(j) + " * 3: a = " +
+                 std::to_string(j) + "; break;\n";
+    }
+    InitParserFromSource("large_switch.c",
+                         "void f(int a) {\n    switch (a) {\n" + cases +
+                         "    default: break;\n    }\n}\n");
+    const TransUnit& tu = parserp_->Parse();
+    tu.Print(std::cout);
+    EXPECT_EQ(cerr_buf_.str(), "");
+    EXPECT_EQ(CountSubstr(cout_buf_.str(), "IfStmt"), 10000);
+
+    SwitchCollector collector{};
+    Walk(tu, collector);
+    ASSERT_EQ(collector.tables_.size(), 1u);
+    const CaseTable& table = *collector.tables_[0];
+    EXPECT_EQ(table.Size(), 10000u);
+    const auto& entries = table.Entries();
+    EXPECT_TRUE(std::is_sorted(entries.cbegin(), entries.cend(),
+                               [](const auto& lhs, const auto& rhs) {
+                                   return lhs.value < rhs.value;
+                               }));
+    EXPECT_EQ(table.MinValue(), 0);
+    EXPECT_EQ(table.MaxValue(), 29997);
+    // 10000 values spread over [0, 29997].
+    EXPECT_NEAR(table.Density(), 1.0 / 3, 1e-3);
+
+    // Duplicates of the first, a middle and the last value.
+    InitParserFromSource("dup_switch.c",
+                         "void f(int a) {\n    switch (a) {\n" + cases +
+                         "    case 0: break;\n"
+                         "    case 15000: break;\n"
+                         "    case 29997: break;\n"
+                         "    }\n}\n");
+    parserp_->Parse();
+    EXPECT_EQ(CountSubstr(cerr_buf_.str(), "Error: "), 3);
+    EXPECT_EQ(CountSubstr(cerr_buf_.str(), "Error: duplicate case value"), 3);
+}
+
 }
@@ -1,7 +1,13 @@
+#include <cstdio>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <streambuf>
 
 #include "gtest/gtest.h"
+#include "error.hh"
 #include "scanner.hh"
+#include "file_manager.hh"
 // Include cc file instead of header file so we can use private nested class
 // of Preprocessor class directly. Is this the best way?
 #include "preprocessor.cc"
@@ -10,12 +16,30 @@ namespace axcc {
 
 class PreprocessorTest : public ::testing::Test {
 protected:
-    void InitPreprocessor(const std::string& fname) {
-        auto iter = files_.emplace(fname, ReadFile(fname)).first;
-        Scanner scanner{iter->first, iter->second};
+    ~PreprocessorTest() {
+        // Send diagnostics to std::cerr again.
+        DiagEngine::Instance().SetOutput(std::cerr);
+    }
+    void InitPreprocessor(const std::string& fname,
+                          CondCache& cond_cache = CondCache::Instance()) {
+        ResetPreprocessor();
+        fname_ = fname;
+        DiagEngine::Instance().Reset();
+        filep_ = FileManager::Instance().GetFile(fname);
+        // Fall back to an empty file so a missing fixture fails this test
+        // instead of crashing the whole binary.
+        Scanner scanner{fname_, filep_ ? filep_->Content() : empty_};
         tsp_ = scanner.Scan();
         std::list<std::string> header_paths{};
-        ppp_ = std::make_unique<Preprocessor>(*tsp_, files_, header_paths);
+        ppp_ = std::make_unique<Preprocessor>(*tsp_, FileManager::Instance(),
+                                              header_paths, cond_cache);
+        ASSERT_NE(filep_, nullptr) << fname << " not found";
+    }
+    // Destroy the preprocessor of the previous run before the tokens it
+    // refers to.
+    void ResetPreprocessor() {
+        ppp_.reset();
+        tsp_.reset();
     }
     // Accessors of private functions of class Scanner
     bool AddMacro(const Preprocessor::Macro& macro) {
@@ -31,7 +55,9 @@ protected:
                            const std::string& cur_path) {
         return ppp_->FindHeader(fname, include_cur_path, cur_path); }
 
-    std::map<std::string, std::string> files_{};
+    const std::string empty_{};
+    std::string fname_{};
+    std::shared_ptr<const FileEntry> filep_{};
     std::unique_ptr<TokenSequence> tsp_{};
     std::unique_ptr<Preprocessor> ppp_{};
 };
@@ -115,9 +141,9 @@ void ExpectErrorList(std::stringstream& buf,
 
 TEST_F(PreprocessorTest, HandlePPDirectives) {
     InitPreprocessor("directives.c");
-    // Capture std::cerr to check the output
+    // Capture diagnostics to check the output
     std::stringstream output_buf;
-    std::streambuf *orig_buf = std::cerr.rdbuf(output_buf.rdbuf());
+    DiagEngine::Instance().SetOutput(output_buf);
     // Perform preprocessing.
     ppp_->Preprocess();
     // Check the token sequence that has been preprocessed.
@@ -136,7 +162,7 @@ TEST_F(PreprocessorTest, HandlePPDirectives) {
     EXPECT_TRUE(HasMacro("func_macro2"));
     EXPECT_FALSE(HasMacro("obj_macro_ifdef_true"));
     EXPECT_TRUE(HasMacro("obj_macro_ifdef_false"));
-    // Check the output of std::cerr
+    // Check the diagnostics
     std::vector<std::string> err_vec{
         "error in directives_include.h",
         "new_name_in_include:202:2: #error error in directives_include.h",
@@ -184,15 +210,13 @@ TEST_F(PreprocessorTest, HandlePPDirectives) {
         "directives.c:58:8: #ifdef obj_macro2"
     };
     ExpectErrorList(output_buf, err_vec);
-    // Set the original buffer to std::cerr
-    std::cerr.rdbuf(orig_buf);
 }
 
 TEST_F(PreprocessorTest, ExpandMacro) {
     InitPreprocessor("macros.c");
-    // Capture std::cerr to check the output
+    // Capture diagnostics to check the output
     std::stringstream output_buf;
-    std::streambuf *orig_buf = std::cerr.rdbuf(output_buf.rdbuf());
+    DiagEngine::Instance().SetOutput(output_buf);
     // Perform preprocessing
     ppp_->Preprocess();
     // Check the token sequence that has been preprocessed.
@@ -314,7 +338,7 @@ TEST_F(PreprocessorTest, ExpandMacro) {
         {TokenType::IDENTIFIER, "c"},
     };
     EXPECT_TRUE(ExpectTokenSequence(*tsp_, preprocessed));
-    // Check the output of std::cerr
+    // Check the diagnostics
     std::vector<std::string> err_vec{
         "embedding directives within macro arguments is not supported",
         "macros.c:29:1: #define not_supported1",
@@ -330,8 +354,156 @@ TEST_F(PreprocessorTest, ExpandMacro) {
         "macros.c:64:1: fm3(p1,"
     };
     ExpectErrorList(output_buf, err_vec);
-    // Set the original buffer to std::cerr
-    std::cerr.rdbuf(orig_buf);
+}
+
+TEST_F(PreprocessorTest, PreprocessOnly) {
+    InitPreprocessor("pp_output.c");
+    // Tokens should be written to the output stream as soon as they are
+    // final, with spacing and line markers restored.
+    std::stringstream output_buf;
+    ppp_->Preprocess(output_buf);
+    EXPECT_EQ(output_buf.str(), ReadFile("pp_output_i"));
+}
+
+// An unbuffered sink that calls on_write_ with the output so far after each
+// write, so a test can look at the preprocessor while it is writing.
+class WatchedBuf : public std::streambuf {
+public:
+    explicit WatchedBuf(std::function<void(const std::string&)> on_write)
+        : on_write_{std::move(on_write)} {}
+    const std::string& Str() const { return str_; }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            str_ += traits_type::to_char_type(c);
+            on_write_(str_);
+        }
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        str_.append(s, n);
+        on_write_(str_);
+        return n;
+    }
+
+private:
+    std::function<void(const std::string&)> on_write_;
+    std::string str_{};
+};
+
+TEST_F(PreprocessorTest, PreprocessOnlyStreams) {
+    // Output must reach the stream while the input is still being read, not
+    // after the whole token sequence has been rewritten. So the macro on the
+    // last line is not defined yet when the first declaration is written.
+    const std::string fname{::testing::TempDir() + "pp_stream.c"};
+    {
+        std::ofstream src{fname};
+        for (int i = 0; i < 100000; ++i)
+            src << "int g" << i << " = " << i << ";\n";
+        src << "#define pp_stream_end\n";
+    }
+    InitPreprocessor(fname);
+    std::remove(fname.c_str());
+    bool first_written = false;
+    bool defined_at_first = true;
+    WatchedBuf output_buf{[&](const std::string& output) {
+        if (!first_written && output.find("int g0 = 0;") != std::string::npos) {
+            first_written = true;
+            defined_at_first = HasMacro("pp_stream_end");
+        }
+    }};
+    std::ostream output{&output_buf};
+    ppp_->Preprocess(output);
+    EXPECT_TRUE(first_written);
+    EXPECT_FALSE(defined_at_first);
+    EXPECT_TRUE(HasMacro("pp_stream_end"));
+    EXPECT_NE(output_buf.Str().find("int g99999 = 99999;\n"),
+              std::string::npos);
+}
+
+TEST_F(PreprocessorTest, IncludeProfile) {
+    InitPreprocessor("directives.c");
+    // Capture diagnostics to discard the errors in directives.c
+    std::stringstream output_buf;
+    DiagEngine::Instance().SetOutput(output_buf);
+    ppp_->EnableProfiling();
+    ppp_->Preprocess();
+    const PPProfile& profile = ppp_->Profile();
+    // Check the include tree. Token counts include nested headers.
+    const PPProfile::IncludeNode& root = profile.Root();
+    EXPECT_EQ(root.fname, "directives.c");
+    EXPECT_EQ(root.tokens, 5);
+    ASSERT_EQ(root.children.size(), 1);
+    EXPECT_EQ(root.children[0].fname, "directives_include.h");
+    EXPECT_EQ(root.children[0].tokens, 0);
+    EXPECT_TRUE(root.children[0].children.empty());
+    // Each #include with a valid filename probes at least one path.
+    EXPECT_GE(profile.FindHeaderProbes(), 3);
+    // Check the Chrome trace-event output.
+    std::stringstream trace_buf;
+    profile.PrintTraceEvents(trace_buf);
+    EXPECT_EQ(trace_buf.str().find("{\"traceEvents\":["), 0);
+    EXPECT_NE(trace_buf.str().find("\"name\":\"directives_include.h\""),
+              std::string::npos);
+    // Check the top-N summary.
+    std::stringstream summary_buf;
+    profile.PrintSummary(summary_buf, 10);
+    EXPECT_NE(summary_buf.str().find("directives_include.h"),
+              std::string::npos);
+}
+
+TEST_F(PreprocessorTest, MacroProfile) {
+    // Nothing should be recorded unless profiling is enabled.
+    InitPreprocessor("macros.c");
+    std::stringstream output_buf;
+    DiagEngine::Instance().SetOutput(output_buf);
+    ppp_->Preprocess();
+    EXPECT_EQ(ppp_->Profile().MacroStatsOf("om1").expansions, 0);
+
+    InitPreprocessor("macros.c");
+    ppp_->EnableProfiling();
+    ppp_->Preprocess();
+    const PPProfile& profile = ppp_->Profile();
+    // om1 and fm1 are expanded once on their own and once as arguments of
+    // fm5.
+    EXPECT_EQ(profile.MacroStatsOf("om1").expansions, 2);
+    EXPECT_EQ(profile.MacroStatsOf("om1").tokens, 2);
+    EXPECT_EQ(profile.MacroStatsOf("fm1").expansions, 2);
+    EXPECT_EQ(profile.MacroStatsOf("fm1").tokens, 10);
+    EXPECT_EQ(profile.MacroStatsOf("sharp_macro1").expansions, 2);
+    EXPECT_EQ(profile.MacroStatsOf("sharp_macro1").tokens, 2);
+    EXPECT_EQ(profile.MacroStatsOf("macro_not_exist").expansions, 0);
+    std::stringstream summary_buf;
+    profile.PrintSummary(summary_buf, 3);
+    EXPECT_NE(summary_buf.str().find("fm1"), std::string::npos);
+}
+
+TEST_F(PreprocessorTest, ConditionCache) {
+    // Use a cache of our own so earlier tests do not affect the counters.
+    CondCache cond_cache{};
+    InitPreprocessor("if_cache.c", cond_cache);
+    ppp_->Preprocess();
+    std::list<Token> preprocessed{
+        {TokenType::IDENTIFIER, "y_gt_3"},
+        {TokenType::IDENTIFIER, "y_gt_3"},
+        {TokenType::IDENTIFIER, "y_le_3"},
+        {TokenType::IDENTIFIER, "y_le_3"},
+        {TokenType::IDENTIFIER, "x_undef"}
+    };
+    EXPECT_TRUE(ExpectTokenSequence(*tsp_, preprocessed));
+    // Each inclusion evaluates the #if and, when it is false, the #elif.
+    // Results are reused only when none of the referenced macros changed.
+    EXPECT_EQ(cond_cache.Hits(), 3);
+    EXPECT_EQ(cond_cache.Misses(), 5);
+
+    // Another TU in the same process sees the same macro definitions at
+    // each inclusion, so every evaluation is a hit.
+    InitPreprocessor("if_cache.c", cond_cache);
+    ppp_->Preprocess();
+    EXPECT_TRUE(ExpectTokenSequence(*tsp_, preprocessed));
+    EXPECT_EQ(cond_cache.Hits(), 11);
+    EXPECT_EQ(cond_cache.Misses(), 5);
 }
 
 }
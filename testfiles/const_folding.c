@@ -0,0 +1,16 @@
+// Constant folding tests.
+void const_folding(int a) {
+    int i1 = 4 * (2 + 3) >> 1;
+    int i2 = a + 2 * 3;
+    int i3 = 1.5 * 2 + 0.5;
+    double d1 = 1.5 * 3;
+    unsigned int u1 = -1 + 0u;
+    long l1 = 1 + 2L;
+    int i4 = (char)300;
+    a = 2 + 3;
+
+    // Division by zero is diagnosed and left unfolded.
+    int i5 = 1 / 0;
+    // Signed overflow is diagnosed and left unfolded.
+    int i6 = 2147483647 + 1;
+}
@@ -0,0 +1,23 @@
+// Dependency scanning tests.
+#include "deps_include1.h"
+#include "deps_include1.h"
+#ifdef DEPS_INCLUDE1
+#include "deps_include2.h"
+#else
+#include "file_not_exist"
+#endif
+#if DEPS_VERSION > 1
+#include "deps_include3.h"
+#endif
+// Computed include after a #line that renames the file.
+#line 100 "deps_renamed.c"
+#define DEPS_HEADER "deps_include4.h"
+#include DEPS_HEADER
+#undef DEPS_VERSION
+#if defined(DEPS_VERSION)
+#include "file_not_exist"
+#endif
+
+int deps() {
+    return 0;
+}
@@ -0,0 +1,6 @@
+// Included by deps.c.
+#ifndef DEPS_INCLUDE1
+#define DEPS_INCLUDE1
+#define DEPS_VERSION 2
+int deps_include1;
+#endif
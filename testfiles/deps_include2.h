@@ -0,0 +1,3 @@
+// Included by deps.c.
+#include "deps_include3.h"
+int deps_include2;
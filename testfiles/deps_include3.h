@@ -0,0 +1,2 @@
+// Included by deps.c and deps_include2.h.
+int deps_include3;
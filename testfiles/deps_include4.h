@@ -0,0 +1,2 @@
+// Included by deps.c through a macro.
+int deps_include4;
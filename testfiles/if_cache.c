@@ -0,0 +1,16 @@
+// Conditional directive cache tests.
+#define X
+#define Y 4
+#include "if_cache_include.h"
+// None of the referenced macros changed.
+#include "if_cache_include.h"
+// Y is redefined.
+#undef Y
+#define Y 2
+#include "if_cache_include.h"
+// An unrelated macro does not invalidate the result.
+#define Z 1
+#include "if_cache_include.h"
+// X is removed.
+#undef X
+#include "if_cache_include.h"
@@ -0,0 +1,8 @@
+// Included by if_cache.c.
+#if defined(X) && Y > 3
+y_gt_3
+#elif defined(X)
+y_le_3
+#else
+x_undef
+#endif
@@ -0,0 +1,22 @@
+// Interned types tests.
+struct S1 {
+    int m1;
+};
+
+void interned_types() {
+    int i1 = 0;
+    long l1;
+    int* p1 = &i1;
+    int* p2 = p1;
+    long* p3 = &l1;
+    struct S1 s1;
+    struct S1* ps1 = &s1;
+    int a1[2][3];
+
+    // Structurally identical derived types are the same type.
+    _Generic(p1, long*: 1, int*: 2);
+    _Generic(p3, int*: 3, long*: 4);
+    _Generic(ps1, struct S1*: 5, default: 6);
+    _Generic(&a1, int (*)[2][2]: 7, int (*)[2][3]: 8);
+    p2 = p1;
+}
@@ -0,0 +1,25 @@
+// Preprocess-only output tests.
+#include "pp_output_include.h"
+#define om1 (1 + 2)
+#define fm1(p1, p2) p1 * p2
+
+int i1 = om1;
+int i2 = fm1(i1,   3);
+int i3 =
+    __LINE__;
+
+
+
+
+
+
+
+
+
+
+int i4 = om1 + fm1(om1, 2);
+#ifdef om1
+int i5;
+#else
+int i6;
+#endif
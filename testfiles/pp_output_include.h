@@ -0,0 +1,2 @@
+// Included by pp_output.c.
+typedef int pp_int_t;
@@ -0,0 +1,30 @@
+// Operator precedence and associativity tests.
+void precedence() {
+    int a = 1;
+    int b = 2;
+    int c = 3;
+    char ch;
+    long l;
+    double d;
+
+    a * b + c;
+    a + b * c;
+    a - b - c;
+    a / b % c;
+    a << b + c;
+    a < b == c;
+    a == b < c;
+    a & b ^ c | a;
+    a | b ^ c & a;
+    a && b || c && a;
+    a || b && c;
+    a = b = c;
+    a += b * c;
+    a ? b : c ? a : b;
+
+    // Operands are converted below the operator they belong to.
+    l + ch * a;
+    d < a;
+    ch << l;
+    a * d + l;
+}